@@ -0,0 +1,80 @@
+#include "rtweekend.hh"
+
+#include "vec3.hh"
+#include "ray.hh"
+#include "hittable_list.hh"
+#include "camera.hh"
+#include "random_scene.hh"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Measures how fast rays are intersected against the scene of `final`.
+// Rays are generated up front so that only the intersection is timed.
+//
+// This only uses hittable::hit(), so it can also be built against the commit before intersect() was
+// introduced (copy bench.cc and random_scene.hh into that tree) to compare with it.
+
+// Runs world.hit() for all rays `rounds` times and reports the throughput of the fastest round,
+// which is the least disturbed by other processes.
+void bench(const char *name, const hittable &world, const std::vector<ray> &rays, int rounds) {
+    hit_record rec;
+    int hits = 0;
+    double best = infinity;
+    for (int k = 0; k < rounds; ++k) {
+        hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto &r : rays) {
+            if (world.hit(r, 0.001, infinity, rec)) {
+                ++hits;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = fmin(best, elapsed.count());
+    }
+    std::cout << name << ": " << rays.size() / best / 1e6 << " Mrays/s"
+              << " (" << hits << " hits in " << rays.size() << " rays)" << std::endl;
+}
+
+int main() {
+    srand(42);
+
+    // Same settings as final.cc
+    const auto aspect_ratio = 3.0 / 2.0;
+    const int image_width = 1200;
+    const int image_height = static_cast<int>(image_width / aspect_ratio);
+    hittable_list world = random_scene();
+
+    point3 look_from(13, 2, 3);
+    point3 look_at(0, 0, 0);
+    vec3 vup(0, 1, 0);
+    auto dist_to_focus = 10.0;
+    auto aperture = 0.1;
+    lens_camera cam(look_from, look_at, vup, 20, aspect_ratio, aperture, dist_to_focus);
+
+    const int ray_count = 100000;
+    const int rounds = 10;
+
+    std::vector<ray> camera_rays;
+    for (int n = 0; n < ray_count; ++n) {
+        auto u = (random_double() * image_width) / (image_width-1);
+        auto v = (random_double() * image_height) / (image_height-1);
+        camera_rays.push_back(cam.get_ray(u, v));
+    }
+
+    // Rays leaving the surfaces hit by camera rays into random directions, like diffuse bounces.
+    std::vector<ray> bounce_rays;
+    hit_record rec;
+    for (int n = 0; bounce_rays.size() < ray_count; ++n) {
+        const auto &r = camera_rays[n % camera_rays.size()];
+        if (!world.hit(r, 0.001, infinity, rec)) {
+            continue;
+        }
+        auto direction = unit_vector(rec.normal + unit_vector(random_in_unit_sphere()));
+        bounce_rays.push_back(ray(rec.p, direction));
+    }
+
+    bench("camera rays", world, camera_rays, rounds);
+    bench("bounce rays", world, bounce_rays, rounds);
+}
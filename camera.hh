@@ -33,7 +33,7 @@ class ideal_camera : public camera {
         }
 
         ray get_ray(double u, double v) const {
-            return ray(origin, lower_left_corner + u*horizontal + v*vertical - origin);
+            return ray(origin, unit_vector(lower_left_corner + u*horizontal + v*vertical - origin));
         }
 
     private:
@@ -74,7 +74,7 @@ class lens_camera : public camera {
             vec3 rd = lens_radius * random_in_unit_disk();
             vec3 offset = u * rd.x() + v * rd.y();
 
-            return ray(origin + offset, lower_left_corner + s*horizontal + t*vertical - origin - offset);
+            return ray(origin + offset, unit_vector(lower_left_corner + s*horizontal + t*vertical - origin - offset));
         }
 
     private:
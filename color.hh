@@ -5,15 +5,11 @@
 #include <iostream>
 
 // Write out the given color in ppm format
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
-
-    auto scale = 1.0 / samples_per_pixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
+void write_color(std::ostream &out, color pixel_color) {
+    // Filters with negative lobes can make a color slightly negative, which sqrt() can't handle.
+    auto r = sqrt(fmax(0.0, pixel_color.x()));
+    auto g = sqrt(fmax(0.0, pixel_color.y()));
+    auto b = sqrt(fmax(0.0, pixel_color.z()));
 
     out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' '
         << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "rtweekend.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Light coming from infinitely far away, which is what a ray sees when it doesn't hit anything.
+class environment {
+    public:
+        // Returns the radiance arriving from the given direction.
+        virtual color value(const vec3 &direction) const = 0;
+
+        // Chooses a unit direction to sample the light from, and reports the probability density
+        // (per solid angle) of choosing it in pdf.
+        virtual vec3 sample(double &pdf) const = 0;
+
+        // Returns the probability density of sample() choosing the given direction.
+        virtual double pdf(const vec3 &direction) const = 0;
+
+        // Returns true if sample() follows the distribution of light closely enough that sampling
+        // it directly converges faster than relying on scattered rays alone.
+        // Otherwise the extra shadow rays aren't worth their cost.
+        virtual bool is_importance_sampled() const { return false; }
+};
+
+// White in the bottom, sky-blue on the top.
+class sky_gradient : public environment {
+    public:
+        virtual color value(const vec3 &direction) const override {
+            vec3 unit_direction = unit_vector(direction);
+
+            // Normalize y component of range [-1.0, 1.0] into [0.0, 1.0]
+            auto level = 0.5 * (unit_direction.y() + 1.0);
+
+            return (1.0-level) * color(1.0, 1.0, 1.0) + level*color(0.5, 0.7, 1.0);
+        }
+
+        // Never used by the renderer, as is_importance_sampled() is false: the sky is almost uniform,
+        // so sampling it directly wouldn't beat scattered rays. Kept as a valid uniform sampler to
+        // fulfill the interface.
+        virtual vec3 sample(double &pdf) const override {
+            pdf = 1 / (4*pi);
+            return unit_vector(random_in_unit_sphere());
+        }
+
+        virtual double pdf(const vec3 &direction) const override {
+            return 1 / (4*pi);
+        }
+};
+
+// HDR image in latitude-longitude (equirectangular) projection surrounding the scene.
+// The top row of the image is the zenith (+y) and the u coordinate goes around the y axis.
+//
+// Directions are importance sampled in proportion to the brightness of pixels, so that small but
+// very bright regions like the sun are found without relying on rays hitting them by chance.
+class env_map : public environment {
+    public:
+        // Loads the image from a PFM (Portable Float Map) file.
+        // Radiance is multiplied by intensity.
+        env_map(const std::string &path, double intensity = 1.0) {
+            load_pfm(path, intensity);
+            build_distribution();
+        }
+
+        virtual color value(const vec3 &direction) const override {
+            double u, v;
+            direction_to_uv(unit_vector(direction), u, v);
+            return pixel(to_column(u), to_row(v));
+        }
+
+        virtual vec3 sample(double &pdf) const override {
+            // Choose a row from the marginal distribution, then a column within the row.
+            auto row = sample_cdf(marginal_cdf, 0, height, random_double());
+            auto col = sample_cdf(conditional_cdf, row * (width + 1), width, random_double());
+
+            auto u = (col + random_double()) / width;
+            auto v = (row + random_double()) / height;
+            auto direction = uv_to_direction(u, v);
+            pdf = density(col, row, sin(v * pi));
+            return direction;
+        }
+
+        virtual double pdf(const vec3 &direction) const override {
+            double u, v;
+            direction_to_uv(unit_vector(direction), u, v);
+            return density(to_column(u), to_row(v), sin(v * pi));
+        }
+
+        virtual bool is_importance_sampled() const override { return true; }
+
+    private:
+        int width;
+        int height;
+        std::vector<color> pixels; // Row by row from the top
+
+        // Piecewise-constant 2D distribution over the image.
+        // conditional_cdf holds (width + 1) entries per row, marginal_cdf holds (height + 1) entries.
+        // Both are normalized so that the last entry is 1.
+        std::vector<double> conditional_cdf;
+        std::vector<double> marginal_cdf;
+        std::vector<double> func;     // Unnormalized weight of each pixel
+        double func_integral;         // Average of func over the image
+
+        const color& pixel(int col, int row) const {
+            return pixels[row * width + col];
+        }
+
+        int to_column(double u) const {
+            return std::min(static_cast<int>(u * width), width - 1);
+        }
+
+        int to_row(double v) const {
+            return std::min(static_cast<int>(v * height), height - 1);
+        }
+
+        static void direction_to_uv(const vec3 &d, double &u, double &v) {
+            u = (atan2(d.z(), d.x()) + pi) / (2*pi);
+            v = acos(clamp(d.y(), -1.0, 1.0)) / pi;
+        }
+
+        static vec3 uv_to_direction(double u, double v) {
+            auto phi = 2*pi*u - pi;
+            auto theta = pi * v;
+            return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+        }
+
+        // Converts the density over the image (unit square) into the density per solid angle.
+        // A pixel near the poles covers less solid angle, which the sin(θ) term accounts for.
+        double density(int col, int row, double sin_theta) const {
+            if (func_integral == 0 || sin_theta <= 0) {
+                return 0;
+            }
+            auto pdf_uv = func[row * width + col] / func_integral;
+            return pdf_uv / (2*pi*pi * sin_theta);
+        }
+
+        // Returns the index i in [0, n) such that cdf[offset+i] <= x < cdf[offset+i+1].
+        static int sample_cdf(const std::vector<double> &cdf, int offset, int n, double x) {
+            auto begin = cdf.begin() + offset;
+            auto it = std::upper_bound(begin, begin + n + 1, x);
+            return std::min(std::max(static_cast<int>(it - begin) - 1, 0), n - 1);
+        }
+
+        void build_distribution() {
+            func.resize(width * height);
+            conditional_cdf.resize((width + 1) * height);
+            marginal_cdf.resize(height + 1);
+
+            // Weight each pixel by its luminance, scaled by the solid angle it covers.
+            std::vector<double> row_sums(height);
+            for (int row = 0; row < height; ++row) {
+                auto sin_theta = sin((row + 0.5) / height * pi);
+                auto *cdf = &conditional_cdf[row * (width + 1)];
+                cdf[0] = 0;
+                for (int col = 0; col < width; ++col) {
+                    auto &c = pixel(col, row);
+                    auto f = fmax(0.0, 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z()) * sin_theta;
+                    func[row * width + col] = f;
+                    cdf[col + 1] = cdf[col] + f;
+                }
+                row_sums[row] = cdf[width];
+                for (int col = 1; col <= width; ++col) {
+                    // Rows without any light are never chosen by the marginal distribution,
+                    // so any valid CDF will do for them.
+                    cdf[col] = row_sums[row] > 0 ? cdf[col] / row_sums[row] : double(col) / width;
+                }
+            }
+
+            marginal_cdf[0] = 0;
+            for (int row = 0; row < height; ++row) {
+                marginal_cdf[row + 1] = marginal_cdf[row] + row_sums[row];
+            }
+            auto total = marginal_cdf[height];
+            for (int row = 1; row <= height; ++row) {
+                marginal_cdf[row] = total > 0 ? marginal_cdf[row] / total : double(row) / height;
+            }
+            func_integral = total / (width * height);
+        }
+
+        void load_pfm(const std::string &path, double intensity) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error(path + ": can't open");
+            }
+            std::string magic;
+            double scale;
+            in >> magic >> width >> height >> scale;
+            in.get(); // A single whitespace separates the header from the data
+            if (!in || magic != "PF" || width <= 0 || height <= 0) {
+                throw std::runtime_error(path + ": not a color PFM file");
+            }
+
+            std::vector<float> data(3 * width * height);
+            in.read(reinterpret_cast<char*>(data.data()), sizeof(float) * data.size());
+            if (!in) {
+                throw std::runtime_error(path + ": truncated PFM file");
+            }
+
+            // Negative scale means little endian.
+            const uint16_t probe = 1;
+            bool host_little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+            if ((scale < 0) != host_little_endian) {
+                for (auto &f : data) {
+                    uint32_t bits;
+                    memcpy(&bits, &f, sizeof(bits));
+                    bits = __builtin_bswap32(bits);
+                    memcpy(&f, &bits, sizeof(bits));
+                }
+            }
+
+            // PFM stores rows from the bottom.
+            pixels.resize(width * height);
+            for (int row = 0; row < height; ++row) {
+                auto *src = &data[3 * (height - 1 - row) * width];
+                for (int col = 0; col < width; ++col) {
+                    pixels[row * width + col] = intensity * color(src[3*col], src[3*col + 1], src[3*col + 2]);
+                }
+            }
+        }
+};
@@ -0,0 +1,48 @@
+#include "rtweekend.hh"
+
+#include "color.hh"
+#include "tiled_framebuffer.hh"
+
+#include <iostream>
+
+// Converts a tiled framebuffer written by `final` into a ppm image.
+// Pixels which no rendered tile contributed to come out black.
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " FRAMEBUFFER" << std::endl;
+        return 1;
+    }
+    shared_ptr<tiled_framebuffer> fb;
+    try {
+        fb = make_shared<tiled_framebuffer>(argv[1]);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    int tiles_done = 0;
+    for (int idx = 0; idx < fb->tile_count(); ++idx) {
+        if (fb->is_tile_done(idx)) {
+            ++tiles_done;
+        }
+    }
+    std::cerr << tiles_done << " / " << fb->tile_count() << " tiles rendered" << std::endl;
+
+    std::cout << "P3\n" << fb->width << ' ' << fb->height << std::endl;
+    std::cout << 255 << std::endl;
+
+    // Walk the image one row of tiles at a time, so that only that part of the file (and the borders
+    // of the rows above and below it) is in memory.
+    for (int ty = fb->tiles_y - 1; ty >= 0; --ty) {
+        for (int j = std::min((ty + 1) * fb->tile_size, fb->height) - 1; j >= ty * fb->tile_size; --j) {
+            for (int i = 0; i < fb->width; ++i) {
+                write_color(std::cout, fb->pixel_color(i, j));
+            }
+        }
+        // The row above doesn't reach any pixel below this row.
+        if (ty + 1 < fb->tiles_y) {
+            fb->release_tile_row(ty + 1);
+        }
+    }
+    fb->release_tile_row(0);
+}
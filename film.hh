@@ -0,0 +1,122 @@
+#pragma once
+
+#include "rtweekend.hh"
+#include "filter.hh"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// Image plane coordinates used in this file:
+// (x, y) ∈ [0, width) × [0, height), where y grows upward like the v coordinate of cameras.
+// Pixel (i, j) covers [i, i+1) × [j, j+1) and its center is (i+0.5, j+0.5).
+
+struct film_pixel {
+    color color_sum;
+    double weight_sum = 0;
+
+    // Returns the reconstructed color of this pixel.
+    color value() const {
+        // Filters with negative lobes may yield non-positive weight when only a few samples
+        // contributed. Treat such pixels as black rather than dividing by garbage.
+        if (weight_sum <= 0) {
+            return color(0, 0, 0);
+        }
+        return color_sum / weight_sum;
+    }
+};
+
+// Local accumulation buffer for a rectangular region of the film.
+// A tile is meant to be owned by a single thread, so adding samples doesn't need any locking.
+// Once the tile is done, merge it into the film with film::merge_tile(), or store it in a
+// tiled_framebuffer.
+class film_tile {
+    public:
+        // The tile is responsible for pixels [x0, x1) × [y0, y1), but it also stores a border
+        // around them as samples near the edge spill over to the neighboring pixels.
+        film_tile(int x0, int y0, int x1, int y1, const filter_table &table)
+            : x0(x0), y0(y0), x1(x1), y1(y1), table(table)
+        {
+            auto border = table.border();
+            bx0 = x0 - border;
+            by0 = y0 - border;
+            bx1 = x1 + border;
+            by1 = y1 + border;
+            pixels.resize((bx1 - bx0) * (by1 - by0));
+        }
+
+        // Splat a sample at (x, y) into every pixel whose center is within the filter radius.
+        void add_sample(double x, double y, const color &c) {
+            auto from_i = std::max(bx0, static_cast<int>(ceil(x - 0.5 - table.radius)));
+            auto to_i = std::min(bx1 - 1, static_cast<int>(floor(x - 0.5 + table.radius)));
+            auto from_j = std::max(by0, static_cast<int>(ceil(y - 0.5 - table.radius)));
+            auto to_j = std::min(by1 - 1, static_cast<int>(floor(y - 0.5 + table.radius)));
+
+            for (int j = from_j; j <= to_j; ++j) {
+                auto wy = table.evaluate_1d(j + 0.5 - y);
+                if (wy == 0) continue;
+                for (int i = from_i; i <= to_i; ++i) {
+                    auto w = wy * table.evaluate_1d(i + 0.5 - x);
+                    auto &p = pixel(i, j);
+                    p.color_sum += w * c;
+                    p.weight_sum += w;
+                }
+            }
+        }
+
+        film_pixel& pixel(int i, int j) {
+            return pixels[(j - by0) * (bx1 - bx0) + (i - bx0)];
+        }
+
+        const film_pixel& pixel(int i, int j) const {
+            return pixels[(j - by0) * (bx1 - bx0) + (i - bx0)];
+        }
+
+    public:
+        // Pixels this tile is responsible for
+        int x0, y0, x1, y1;
+        // Pixels stored in this tile, including the border
+        int bx0, by0, bx1, by1;
+
+    private:
+        const filter_table &table;
+        std::vector<film_pixel> pixels;
+};
+
+// Framebuffer that reconstructs the image from samples weighted by a filter.
+class film {
+    public:
+        film(int width, int height, const filter &f)
+            : width(width), height(height), table(f), pixels(static_cast<size_t>(width) * height) {}
+
+        film_tile make_tile(int x0, int y0, int x1, int y1) const {
+            return film_tile(x0, y0, x1, y1, table);
+        }
+
+        // Add all samples in the tile to this film. Safe to be called from multiple threads.
+        void merge_tile(const film_tile &tile) {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (int j = std::max(tile.by0, 0); j < std::min(tile.by1, height); ++j) {
+                for (int i = std::max(tile.bx0, 0); i < std::min(tile.bx1, width); ++i) {
+                    auto &src = tile.pixel(i, j);
+                    auto &dst = pixels[static_cast<size_t>(j) * width + i];
+                    dst.color_sum += src.color_sum;
+                    dst.weight_sum += src.weight_sum;
+                }
+            }
+        }
+
+        // Returns the reconstructed color of pixel (i, j).
+        color pixel_color(int i, int j) const {
+            return pixels[static_cast<size_t>(j) * width + i].value();
+        }
+
+    public:
+        const int width;
+        const int height;
+
+    private:
+        filter_table table;
+        std::vector<film_pixel> pixels;
+        std::mutex mtx;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "rtweekend.hh"
+
+#include <vector>
+
+// Pixel reconstruction filter.
+// All filters here are separable: a sample located at offset (x, y) from a pixel center contributes
+// to that pixel with weight evaluate_1d(x) * evaluate_1d(y).
+// Samples farther than `radius` on either axis contribute nothing.
+class filter {
+    public:
+        filter(double radius) : radius(radius) {}
+
+        virtual double evaluate_1d(double x) const = 0;
+
+        // Short identifier of the filter, e.g. to check that two renders used the same one.
+        virtual const char* name() const = 0;
+
+    public:
+        double radius;
+};
+
+// Equivalent to averaging the samples within a pixel.
+class box_filter : public filter {
+    public:
+        box_filter(double radius = 0.5) : filter(radius) {}
+
+        virtual const char* name() const override { return "box"; }
+
+        virtual double evaluate_1d(double x) const override {
+            return fabs(x) <= radius ? 1.0 : 0.0;
+        }
+};
+
+class gaussian_filter : public filter {
+    public:
+        // Larger alpha makes the falloff steeper (sharper image).
+        gaussian_filter(double radius = 1.5, double alpha = 2.0)
+            : filter(radius), alpha(alpha), exp_at_radius(exp(-alpha * radius * radius)) {}
+
+        virtual const char* name() const override { return "gaussian"; }
+
+        virtual double evaluate_1d(double x) const override {
+            // Shift the curve down so that it reaches exactly 0 at the radius instead of being cut off.
+            return fmax(0.0, exp(-alpha * x * x) - exp_at_radius);
+        }
+
+    private:
+        double alpha;
+        double exp_at_radius;
+};
+
+// Mitchell-Netravali filter. The default (B, C) = (1/3, 1/3) is the one recommended by the paper
+// as a good balance between blurring and ringing.
+// Note that this filter has negative lobes.
+class mitchell_filter : public filter {
+    public:
+        mitchell_filter(double radius = 2.0, double b = 1.0/3.0, double c = 1.0/3.0)
+            : filter(radius), b(b), c(c) {}
+
+        virtual const char* name() const override { return "mitchell"; }
+
+        virtual double evaluate_1d(double x) const override {
+            // The original cubic is defined over [-2, 2].
+            x = fabs(2.0 * x / radius);
+            if (x > 2.0) {
+                return 0.0;
+            }
+            if (x > 1.0) {
+                return ((-b - 6*c) * x*x*x + (6*b + 30*c) * x*x + (-12*b - 48*c) * x + (8*b + 24*c)) / 6.0;
+            }
+            return ((12 - 9*b - 6*c) * x*x*x + (-18 + 12*b + 6*c) * x*x + (6 - 2*b)) / 6.0;
+        }
+
+    private:
+        double b, c;
+};
+
+// Four-term Blackman-Harris window. Very little ringing while being sharper than Gaussian.
+class blackman_harris_filter : public filter {
+    public:
+        blackman_harris_filter(double radius = 2.0) : filter(radius) {}
+
+        virtual const char* name() const override { return "blackman-harris"; }
+
+        virtual double evaluate_1d(double x) const override {
+            if (fabs(x) > radius) {
+                return 0.0;
+            }
+            // Map [-radius, radius] onto the window position [0, 1].
+            auto n = 0.5 + 0.5 * x / radius;
+            return 0.35875
+                - 0.48829 * cos(2 * pi * n)
+                + 0.14128 * cos(4 * pi * n)
+                - 0.01168 * cos(6 * pi * n);
+        }
+};
+
+// Precomputed table of filter weights, so that splatting a sample doesn't need to evaluate
+// exp() or cos() for every pixel it touches.
+// Only the 1D weights over [0, radius] are stored thanks to the symmetry and separability.
+class filter_table {
+    public:
+        static const int table_size = 64;
+
+        filter_table(const filter &f) : name(f.name()), radius(f.radius), inv_step(table_size / f.radius), weights(table_size) {
+            for (int i = 0; i < table_size; ++i) {
+                // Sample at the middle of each bucket.
+                weights[i] = f.evaluate_1d((i + 0.5) / inv_step);
+            }
+        }
+
+        double evaluate_1d(double x) const {
+            auto idx = static_cast<int>(fabs(x) * inv_step);
+            return idx < table_size ? weights[idx] : 0.0;
+        }
+
+        // Returns how many pixels around a region samples inside of the region can reach.
+        int border() const {
+            return static_cast<int>(ceil(radius - 0.5));
+        }
+
+    public:
+        const char *name;
+        double radius;
+
+    private:
+        double inv_step;
+        std::vector<double> weights;
+};
@@ -7,55 +7,22 @@
 #include "sphere.hh"
 #include "camera.hh"
 #include "material.hh"
+#include "environment.hh"
+#include "film.hh"
+#include "tiled_framebuffer.hh"
+#include "random_scene.hh"
 
 #include <iostream>
 
-hittable_list random_scene() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -11; a < 11; ++a) {
-        for (int b = -11; b < 11; ++b) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            if ((center - point3(4, 0.2, 0)).length() <= 0.9) {
-                continue;
-            }
-
-            if (choose_mat < 0.8) {
-                auto albedo = color::random() * color::random();
-                auto sphere_material = make_shared<lambertian>(albedo);
-                world.add(make_shared<sphere>(center, 0.2, sphere_material));
-            } else if (choose_mat < 0.95) {
-                auto albedo = color::random(0.5, 1);
-                auto fuzz = random_double(0, 0.5);
-                auto sphere_material = make_shared<metal>(albedo, fuzz);
-                world.add(make_shared<sphere>(center, 0.2, sphere_material));
-            } else {
-                auto sphere_material = make_shared<dielectric>(1.5);
-                world.add(make_shared<sphere>(center, 0.2, sphere_material));
-            }
-        }
-    }
-
-    // The glass ball
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
-
-    // The ball
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
-
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
-
-    return world;
+// Weight for multiple importance sampling by the power heuristic, which blends light sampling and
+// BRDF sampling so that each one covers the cases where the other one is noisy.
+inline double power_heuristic(double pdf, double other_pdf) {
+    return pdf*pdf / (pdf*pdf + other_pdf*other_pdf);
 }
 
-color ray_color(const ray& r, const hittable& world, int depth) {
+// prev_pdf is the density with which the previous bounce chose r by BRDF sampling.
+// It is 0 for camera rays and rays scattered off specular surfaces, whose light isn't sampled directly.
+color ray_color(const ray& r, const hittable& world, const environment& env, int depth, double prev_pdf = 0) {
     hit_record rec;
 
     // The ray can't bounce anymore. It's dissolved into the darkness...
@@ -69,27 +36,54 @@ color ray_color(const ray& r, const hittable& world, int depth) {
     if (world.hit(r, 0.001, infinity, rec)) {
         ray scattered;
         color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
-            return attenuation * ray_color(scattered, world, depth-1);
-        } else {
+        if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
             return color(0, 0, 0);
         }
-    }
-
-    vec3 unit_direction = unit_vector(r.direction());
 
-    // Normalize y component of range [-1.0, 1.0] into [0.0, 1.0]
-    auto level = 0.5 * (unit_direction.y() + 1.0);
+        // Sample the light directly only when the environment is worth it. Otherwise scatter_pdf
+        // stays 0, so that the light reached by the scattered ray is taken with its full weight.
+        double scatter_pdf = 0;
+        if (env.is_importance_sampled()) {
+            scatter_pdf = rec.mat_ptr->scattering_pdf(r, rec, scattered.direction());
+        }
+        color direct(0, 0, 0);
+        if (scatter_pdf > 0) {
+            double light_pdf;
+            auto light_dir = env.sample(light_pdf);
+            auto brdf_pdf = rec.mat_ptr->scattering_pdf(r, rec, light_dir);
+            // Only whether something blocks the light matters, so skip computing the hit record.
+            double shadow_t;
+            const primitive *shadow_prim;
+            if (light_pdf > 0 && brdf_pdf > 0 && !world.intersect(ray(rec.p, light_dir), 0.001, infinity, shadow_t, shadow_prim)) {
+                direct = attenuation * brdf_pdf * env.value(light_dir) / light_pdf
+                    * power_heuristic(light_pdf, brdf_pdf);
+            }
+        }
+        return direct + attenuation * ray_color(scattered, world, env, depth-1, scatter_pdf);
+    }
 
-    // (roughly) white in the bottom, sky-blue on the top
-    return (1.0-level) * color(1.0, 1.0, 1.0) + level*color(0.5, 0.7, 1.0);
+    if (prev_pdf > 0) {
+        // The light from this direction may have been sampled directly at the previous bounce.
+        return env.value(r.direction()) * power_heuristic(prev_pdf, env.pdf(r.direction()));
+    }
+    return env.value(r.direction());
 }
 
 
 int main(int argc, char **argv) {
+    if (argc != 5 && argc != 6) {
+        std::cerr << "Usage: " << argv[0] << " SEED FRAMEBUFFER WORKER_INDEX WORKER_COUNT [ENVMAP.pfm]" << std::endl;
+        return 1;
+    }
     int seed = std::stoi(std::string(argv[1]));
-    int from_scanline = std::stoi(std::string(argv[2]));
-    int to_scanline = std::stoi(std::string(argv[3]));
+    std::string framebuffer_path = argv[2];
+    int worker_index = std::stoi(std::string(argv[3]));
+    int worker_count = std::stoi(std::string(argv[4]));
+    if (worker_count <= 0 || worker_index < 0 || worker_count <= worker_index) {
+        std::cerr << "Usage: " << argv[0] << " SEED FRAMEBUFFER WORKER_INDEX WORKER_COUNT [ENVMAP.pfm]" << std::endl;
+        std::cerr << "WORKER_INDEX must be in [0, WORKER_COUNT)" << std::endl;
+        return 1;
+    }
 
     srand(seed);
 
@@ -103,6 +97,22 @@ int main(int argc, char **argv) {
     // World settings
     hittable_list world = random_scene();
 
+    // Lighting settings
+    shared_ptr<environment> env;
+    if (argc == 6) {
+        try {
+            env = make_shared<env_map>(argv[5]);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    } else {
+        env = make_shared<sky_gradient>();
+    }
+
+    // All workers must share the same scene, but their samples shouldn't be correlated.
+    srand(seed + worker_index);
+
     // Camera settings
     point3 look_from(13, 2, 3);
     point3 look_at(0, 0, 0);
@@ -112,23 +122,45 @@ int main(int argc, char **argv) {
     //shared_ptr<camera> cam = make_shared<ideal_camera>(look_from, look_at, vup, 20, aspect_ratio);
     shared_ptr<camera> cam = make_shared<lens_camera>(look_from, look_at, vup, 20, aspect_ratio, aperture, dist_to_focus);
 
+    // Film settings
+    const int tile_size = 64;
+    //auto table = filter_table(gaussian_filter());
+    //auto table = filter_table(blackman_harris_filter());
+    auto table = filter_table(mitchell_filter());
+    tiled_framebuffer_scene scene(seed, samples_per_pixel, table.name, argc == 6 ? argv[5] : "");
+    shared_ptr<tiled_framebuffer> fb;
+    try {
+        fb = make_shared<tiled_framebuffer>(framebuffer_path, image_width, image_height, tile_size, table.border(), scene);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     // Render
-    std::cout << "P3\n" << image_width << ' ' << image_height << std::endl;
-    std::cout << 255 << std::endl;
-
-    for (int j = from_scanline; j >= to_scanline; --j) {
-        std::cerr << "\rScanlines remaining: " << j << "   " << std::flush;
-
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = double(i + random_double()) / (image_width-1);
-                auto v = double(j + random_double()) / (image_height-1);
-                ray r = cam->get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+    // Each worker takes every worker_count-th tile. Tiles already in the framebuffer are skipped,
+    // so an interrupted render can be resumed by running the same command again.
+    for (int idx = worker_index; idx < fb->tile_count(); idx += worker_count) {
+        std::cerr << "\rTiles remaining: " << (fb->tile_count() - idx + worker_count - 1) / worker_count << "   " << std::flush;
+        if (fb->is_tile_done(idx)) {
+            continue;
+        }
+
+        int x0, y0, x1, y1;
+        fb->tile_bounds(idx, x0, y0, x1, y1);
+        film_tile tile(x0, y0, x1, y1, table);
+
+        // Samples spilling over to the neighboring tiles are kept in the border of this tile.
+        for (int j = y0; j < y1; ++j) {
+            for (int i = x0; i < x1; ++i) {
+                for (int s = 0; s < samples_per_pixel; ++s) {
+                    auto x = i + random_double();
+                    auto y = j + random_double();
+                    ray r = cam->get_ray(x / (image_width-1), y / (image_height-1));
+                    tile.add_sample(x, y, ray_color(r, world, *env, max_depth));
+                }
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
         }
+        fb->write_tile(idx, tile);
     }
     std::cerr << std::endl << "Done" << std::endl;
 }
\ No newline at end of file
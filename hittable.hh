@@ -18,10 +18,38 @@ struct hit_record {
     }
 };
 
+class primitive;
+
+// Anything rays can be intersected with, either a single primitive or an aggregate of them.
 class hittable {
     public:
+        // Returns true if the ray hits this object. The hit point must be between
+        // r.origin()+t_min*r.direction() and r.origin()+t_max*r.direction().
+        // If it returns true, the parameter of the nearest hit point is stored in t and the primitive
+        // hit by the ray in prim. Use prim->get_hit_record() to get the details of the hit point.
+        virtual bool intersect(
+            const ray& r, double t_min, double t_max, double& t, const primitive*& prim) const = 0;
+
         // Returns true if the ray hits this object. The hit point must be between
         // r.origin()+t_min*r.direction() and r.origin()+t_max*r.direction().
         // If it returns true, details of hit point will be stored in rec.
-        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
-};
\ No newline at end of file
+        bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const;
+};
+
+// A single object, which can describe the point hit by a ray.
+class primitive : public hittable {
+    public:
+        // Computes the details of the point r.at(t) on this primitive, which must have been reported
+        // by intersect(). It's called only once for the closest hit, after all intersection tests.
+        virtual void get_hit_record(const ray& r, double t, hit_record& rec) const = 0;
+};
+
+inline bool hittable::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    double t;
+    const primitive *prim;
+    if (!intersect(r, t_min, t_max, t, prim)) {
+        return false;
+    }
+    prim->get_hit_record(r, t, rec);
+    return true;
+}
\ No newline at end of file
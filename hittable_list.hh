@@ -18,25 +18,25 @@ class hittable_list : public hittable {
             objects.push_back(object);
         }
 
-        virtual bool hit(
-            const ray& r, double t_min, double t_max, hit_record& rec) const override;
-        
+        virtual bool intersect(
+            const ray& r, double t_min, double t_max, double& t, const primitive*& prim) const override;
+
     private:
         std::vector<shared_ptr<hittable>> objects;
 };
 
-// Returns true if the ray hits anything in this list and reports the details in rec.
+// Returns true if the ray hits anything in this list and reports the hit point in t and prim.
 // If the ray hits against multiple objects, reports the nearest one.
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    hit_record temp_rec;
+bool hittable_list::intersect(
+    const ray& r, double t_min, double t_max, double& t, const primitive*& prim) const
+{
     bool hit_anything = false;
     auto closest_so_far = t_max;
 
     for (const auto& object : objects) {
-        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+        if (object->intersect(r, t_min, closest_so_far, t, prim)) {
             hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
+            closest_so_far = t;
         }
     }
     return hit_anything;
@@ -1,8 +0,0 @@
-cat final-fragments/01.ppm > 24-final.ppm
-tail -n +4 final-fragments/02.ppm >> 24-final.ppm
-tail -n +4 final-fragments/03.ppm >> 24-final.ppm
-tail -n +4 final-fragments/04.ppm >> 24-final.ppm
-tail -n +4 final-fragments/05.ppm >> 24-final.ppm
-tail -n +4 final-fragments/06.ppm >> 24-final.ppm
-tail -n +4 final-fragments/07.ppm >> 24-final.ppm
-tail -n +4 final-fragments/08.ppm >> 24-final.ppm
\ No newline at end of file
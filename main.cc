@@ -7,6 +7,7 @@
 #include "sphere.hh"
 #include "camera.hh"
 #include "material.hh"
+#include "film.hh"
 
 #include <iostream>
 
@@ -71,22 +72,38 @@ int main() {
     //shared_ptr<camera> cam = make_shared<ideal_camera>(look_from, look_at, vup, 20, aspect_ratio);
     shared_ptr<camera> cam = make_shared<lens_camera>(look_from, look_at, vup, 20, aspect_ratio, aperture, dist_to_focus);
 
+    // Film settings
+    const int tile_size = 64;
+    film img(image_width, image_height, mitchell_filter());
+
     // Render
+    // Samples near the edge of a tile spill over to the neighboring tiles, which is sorted out when
+    // the tiles are merged into the film.
+    for (int ty = image_height-1; ty >= 0; ty -= tile_size) {
+        std::cerr << "\rScanlines remaining: " << ty + 1 << "   " << std::flush;
+
+        for (int tx = 0; tx < image_width; tx += tile_size) {
+            auto tile = img.make_tile(tx, std::max(ty + 1 - tile_size, 0), std::min(tx + tile_size, image_width), ty + 1);
+            for (int j = tile.y0; j < tile.y1; ++j) {
+                for (int i = tile.x0; i < tile.x1; ++i) {
+                    for (int s = 0; s < samples_per_pixel; ++s) {
+                        auto x = i + random_double();
+                        auto y = j + random_double();
+                        ray r = cam->get_ray(x / (image_width-1), y / (image_height-1));
+                        tile.add_sample(x, y, ray_color(r, world, max_depth));
+                    }
+                }
+            }
+            img.merge_tile(tile);
+        }
+    }
+
     std::cout << "P3\n" << image_width << ' ' << image_height << std::endl;
     std::cout << 255 << std::endl;
 
     for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << "   " << std::flush;
-
         for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = double(i + random_double()) / (image_width-1);
-                auto v = double(j + random_double()) / (image_height-1);
-                ray r = cam->get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
-            }
-            write_color(std::cout, pixel_color, samples_per_pixel);
+            write_color(std::cout, img.pixel_color(i, j));
         }
     }
     std::cerr << std::endl << "Done" << std::endl;
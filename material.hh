@@ -11,6 +11,14 @@ class material {
         // and to which direction the ray should be scattered.
         virtual bool scatter(
             const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const = 0;
+
+        // Returns the probability density (per solid angle) of scatter() choosing the given direction.
+        // For this density, attenuation * scattering_pdf() equals BRDF * cos(θ), so light sources can
+        // also be sampled directly.
+        // Materials that scatter only into a single direction, like mirrors, return 0.
+        virtual double scattering_pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const {
+            return 0;
+        }
 };
 
 class lambertian : public material {
@@ -30,10 +38,18 @@ class lambertian : public material {
                 scatter_direction = rec.normal;
             }
 
-            scattered = ray(rec.p, scatter_direction);
+            scattered = ray(rec.p, unit_vector(scatter_direction));
             attenuation = albedo;
             return true;
         }
+
+        virtual double scattering_pdf(
+            const ray &r_in, const hit_record &rec, const vec3 &direction
+        ) const override {
+            // Lambert's cosine law
+            auto cosine = dot(rec.normal, unit_vector(direction));
+            return cosine < 0 ? 0 : cosine / pi;
+        }
     private:
         color albedo;
 };
@@ -45,8 +61,8 @@ class metal : public material {
         virtual bool scatter(
             const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered
         ) const override {
-            vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
+            vec3 reflected = reflect(r_in.direction(), rec.normal);
+            scattered = ray(rec.p, unit_vector(reflected + fuzz * random_in_unit_sphere()));
             attenuation = albedo;
             return dot(scattered.direction(), rec.normal) > 0;
         }
@@ -64,7 +80,7 @@ class dielectric : public material {
         ) const override {
             attenuation = color(1.0, 1.0, 1.0);
             double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
-            vec3 unit_direction = unit_vector(r_in.direction());
+            vec3 unit_direction = r_in.direction();
             auto cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
             auto sin_theta = sqrt(1.0 - cos_theta*cos_theta);
 
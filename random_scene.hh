@@ -0,0 +1,53 @@
+#pragma once
+
+#include "rtweekend.hh"
+
+#include "hittable_list.hh"
+#include "sphere.hh"
+#include "material.hh"
+
+// The scene on the cover of the book: three big balls surrounded by hundreds of small random ones.
+hittable_list random_scene() {
+    hittable_list world;
+
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -11; a < 11; ++a) {
+        for (int b = -11; b < 11; ++b) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() <= 0.9) {
+                continue;
+            }
+
+            if (choose_mat < 0.8) {
+                auto albedo = color::random() * color::random();
+                auto sphere_material = make_shared<lambertian>(albedo);
+                world.add(make_shared<sphere>(center, 0.2, sphere_material));
+            } else if (choose_mat < 0.95) {
+                auto albedo = color::random(0.5, 1);
+                auto fuzz = random_double(0, 0.5);
+                auto sphere_material = make_shared<metal>(albedo, fuzz);
+                world.add(make_shared<sphere>(center, 0.2, sphere_material));
+            } else {
+                auto sphere_material = make_shared<dielectric>(1.5);
+                world.add(make_shared<sphere>(center, 0.2, sphere_material));
+            }
+        }
+    }
+
+    // The glass ball
+    auto material1 = make_shared<dielectric>(1.5);
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    // The ball
+    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0);
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    return world;
+}
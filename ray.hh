@@ -2,6 +2,9 @@
 
 #include "vec3.hh"
 
+// Half-line from origin toward direction.
+// The direction must be a unit vector, so that t is the distance from the origin and intersection
+// tests can skip normalizing it.
 class ray {
     public:
         ray() {}
@@ -3,39 +3,57 @@
 #include "hittable.hh"
 #include "vec3.hh"
 
-class sphere : public hittable {
+class sphere : public primitive {
     public:
         sphere() {}
         sphere(point3 cen, double r, shared_ptr<material> m)
-            : center(cen), radius(r), mat_ptr(m) {}
+            : center(cen), radius(r), radius_squared(r*r), inv_radius(1/r), mat_ptr(m) {}
 
-        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+        virtual bool intersect(
+            const ray& r, double t_min, double t_max, double& t, const primitive*& prim) const override;
+        virtual void get_hit_record(const ray& r, double t, hit_record& rec) const override;
     private:
         point3 center;
         double radius;
+        double radius_squared;
+        double inv_radius; // Negative for a sphere with negative radius, which flips the normal
         shared_ptr<material> mat_ptr;
 };
 
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+bool sphere::intersect(
+    const ray& r, double t_min, double t_max, double& t, const primitive*& prim) const
+{
     // Solve a quadratic equation to find a real number `t` where
     // r.origin() + t*r.direction() is on this sphere.
+    // As r.direction() is a unit vector, the coefficient of t^2 is 1.
     vec3 oc = r.origin() - center;
-    auto a = r.direction().length_squared();
     auto half_b = dot(oc, r.direction());
-    auto c = oc.length_squared() - radius*radius;
-    auto discriminant = half_b*half_b - a*c;
+    auto c = oc.length_squared() - radius_squared;
 
+    // The origin is outside of the sphere and the ray is going away from it.
+    if (c > 0 && half_b > 0) {
+        return false;
+    }
+
+    auto discriminant = half_b*half_b - c;
     if (discriminant < 0) {
         return false;
     }
+
+    // The whole sphere is farther than t_max, i.e. -half_b - sqrt(discriminant) > t_max.
+    // Most of the objects are rejected here once a close hit is found, without computing sqrt.
+    auto beyond = -half_b - t_max;
+    if (beyond > 0 && beyond*beyond > discriminant) {
+        return false;
+    }
     auto sqrtd = sqrt(discriminant);
 
     // First root
-    auto root = (-half_b - sqrtd) / a;
+    auto root = -half_b - sqrtd;
 
     // If the first root is not within the expected range, try the other one
     if (root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
+        root = -half_b + sqrtd;
     }
 
     // If neither root works, the ray is not considered hitting this sphere.
@@ -43,10 +61,15 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
         return false;
     }
 
-    rec.t = root;
-    rec.p = r.at(rec.t);
-    vec3 outward_normal = (rec.p - center) / radius;
+    t = root;
+    prim = this;
+    return true;
+}
+
+void sphere::get_hit_record(const ray& r, double t, hit_record& rec) const {
+    rec.t = t;
+    rec.p = r.at(t);
+    vec3 outward_normal = (rec.p - center) * inv_radius;
     rec.set_face_normal(r, outward_normal);
     rec.mat_ptr = mat_ptr;
-    return true;
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "rtweekend.hh"
+#include "film.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Framebuffer stored in a memory-mapped file, split into square tiles.
+//
+// File layout:
+//   header     (tiled_framebuffer_header)
+//   tile flags (uint32_t per tile; non-zero once the tile is completely written)
+//   tile data  (aligned to 64KiB; per tile, (tile_size + 2*border)^2 pixels of float RGB weighted
+//               sum and float weight sum, covering the tile and the border around it.
+//               Rows inside a tile are stored bottom to top like the image plane)
+//
+// Samples near the edge of a tile also contribute to the pixels of the neighboring tiles through the
+// filter. Each tile keeps these contributions in its own border, and they are summed up when the
+// pixel is read, so tiles can be rendered independently without tracing extra rays.
+//
+// The file is created at its full size up front. Unwritten tiles read as zero and have their flag
+// cleared, so a partially rendered file is always valid. Tiles can be written independently by
+// multiple threads or processes sharing the same file, and only the pages of the touched tiles are
+// ever loaded into memory.
+//
+// The header also records the inputs of the render, so that resuming it with different settings
+// is rejected instead of stitching tiles of two different images together.
+
+// Inputs of the render that all tiles in a framebuffer must share.
+struct tiled_framebuffer_scene {
+    uint32_t seed;
+    uint32_t samples_per_pixel;
+    char filter_name[16];
+    uint64_t environment_hash; // Hash of the environment map path, or 0 if there is none
+
+    tiled_framebuffer_scene() = default;
+    tiled_framebuffer_scene(int seed, int samples_per_pixel, const char *filter_name, const std::string &environment_path)
+        : seed(seed), samples_per_pixel(samples_per_pixel), filter_name{}, environment_hash(0)
+    {
+        strncpy(this->filter_name, filter_name, sizeof(this->filter_name) - 1);
+        if (!environment_path.empty()) {
+            // 64-bit FNV-1a, which is stable across compilers unlike std::hash
+            environment_hash = 14695981039346656037ull;
+            for (unsigned char c : environment_path) {
+                environment_hash = (environment_hash ^ c) * 1099511628211ull;
+            }
+        }
+    }
+
+    bool operator==(const tiled_framebuffer_scene &other) const {
+        return seed == other.seed
+            && samples_per_pixel == other.samples_per_pixel
+            && strncmp(filter_name, other.filter_name, sizeof(filter_name)) == 0
+            && environment_hash == other.environment_hash;
+    }
+};
+
+struct tiled_framebuffer_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    uint32_t border;
+    tiled_framebuffer_scene scene;
+};
+
+class tiled_framebuffer {
+    public:
+        // Opens the framebuffer at path for writing, creating it if it doesn't exist yet.
+        // An existing file must have the same dimensions and scene.
+        // border must be the border of the film tiles written to this framebuffer.
+        tiled_framebuffer(
+            const std::string &path, int width, int height, int tile_size, int border,
+            const tiled_framebuffer_scene &scene)
+            : width(width), height(height), tile_size(tile_size), border(border)
+        {
+            fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0) {
+                fail("open " + path);
+            }
+            // Serialize initialization against other processes opening the same file.
+            if (flock(fd, LOCK_EX) < 0) {
+                fail("flock " + path);
+            }
+            struct stat st;
+            if (fstat(fd, &st) < 0) {
+                fail("fstat " + path);
+            }
+            init_layout();
+            if (st.st_size == 0) {
+                if (ftruncate(fd, file_size) < 0) {
+                    fail("ftruncate " + path);
+                }
+                map(PROT_READ | PROT_WRITE);
+                auto header = reinterpret_cast<tiled_framebuffer_header*>(base);
+                memcpy(header->magic, magic, sizeof(header->magic));
+                header->version = version;
+                header->width = width;
+                header->height = height;
+                header->tile_size = tile_size;
+                header->border = border;
+                header->scene = scene;
+            } else {
+                tiled_framebuffer_header header{};
+                if (!read_header(header) || static_cast<size_t>(st.st_size) != file_size ||
+                    static_cast<int>(header.width) != width || static_cast<int>(header.height) != height ||
+                    static_cast<int>(header.tile_size) != tile_size || static_cast<int>(header.border) != border) {
+                    throw std::runtime_error(path + ": framebuffer with different settings already exists");
+                }
+                if (!(header.scene == scene)) {
+                    throw std::runtime_error(path + ": framebuffer of a different scene (seed, samples per pixel, "
+                        "filter or environment map) already exists");
+                }
+                map(PROT_READ | PROT_WRITE);
+            }
+            if (flock(fd, LOCK_UN) < 0) {
+                fail("flock " + path);
+            }
+        }
+
+        // Opens an existing framebuffer at path for reading.
+        explicit tiled_framebuffer(const std::string &path) {
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                fail("open " + path);
+            }
+            struct stat st;
+            if (fstat(fd, &st) < 0) {
+                fail("fstat " + path);
+            }
+            tiled_framebuffer_header header{};
+            if (!read_header(header)) {
+                throw std::runtime_error(path + ": not a tiled framebuffer");
+            }
+            width = header.width;
+            height = header.height;
+            tile_size = header.tile_size;
+            border = header.border;
+            init_layout();
+            if (static_cast<size_t>(st.st_size) != file_size) {
+                throw std::runtime_error(path + ": truncated tiled framebuffer");
+            }
+            map(PROT_READ);
+        }
+
+        ~tiled_framebuffer() {
+            if (base != MAP_FAILED) {
+                munmap(base, file_size);
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        tiled_framebuffer(const tiled_framebuffer&) = delete;
+        tiled_framebuffer& operator=(const tiled_framebuffer&) = delete;
+
+        int tile_count() const { return tiles_x * tiles_y; }
+
+        // Pixels covered by the tile are [x0, x1) × [y0, y1).
+        // Tiles are numbered from the bottom-left corner, row by row.
+        void tile_bounds(int idx, int &x0, int &y0, int &x1, int &y1) const {
+            x0 = (idx % tiles_x) * tile_size;
+            y0 = (idx / tiles_x) * tile_size;
+            x1 = std::min(x0 + tile_size, width);
+            y1 = std::min(y0 + tile_size, height);
+        }
+
+        bool is_tile_done(int idx) const {
+            return __atomic_load_n(&tile_flags()[idx], __ATOMIC_ACQUIRE) != 0;
+        }
+
+        // Stores the samples accumulated in the film tile, including its border.
+        // The film tile must have the same bounds as the tile idx.
+        void write_tile(int idx, const film_tile &tile) {
+            auto data = tile_data(idx);
+            for (int j = tile.by0; j < tile.by1; ++j) {
+                for (int i = tile.bx0; i < tile.bx1; ++i) {
+                    auto &src = tile.pixel(i, j);
+                    auto p = data + 4 * ((j - tile.by0) * tile_stride + (i - tile.bx0));
+                    p[0] = static_cast<float>(src.color_sum.x());
+                    p[1] = static_cast<float>(src.color_sum.y());
+                    p[2] = static_cast<float>(src.color_sum.z());
+                    p[3] = static_cast<float>(src.weight_sum);
+                }
+            }
+            // Publish the flag only after the data so that readers never see a half-written tile as done.
+            __atomic_store_n(&tile_flags()[idx], 1u, __ATOMIC_RELEASE);
+        }
+
+        // Returns the reconstructed color of pixel (i, j), combining the tile containing it and the
+        // borders of the neighboring tiles. Tiles which aren't done yet are ignored, and pixels in
+        // such a tile are black even if its neighbors spilled over into them.
+        color pixel_color(int i, int j) const {
+            if (!is_tile_done((j / tile_size) * tiles_x + (i / tile_size))) {
+                return color(0, 0, 0);
+            }
+            film_pixel sum;
+            for (int ty = std::max(j - border, 0) / tile_size; ty <= std::min((j + border) / tile_size, tiles_y - 1); ++ty) {
+                for (int tx = std::max(i - border, 0) / tile_size; tx <= std::min((i + border) / tile_size, tiles_x - 1); ++tx) {
+                    auto idx = ty * tiles_x + tx;
+                    if (!is_tile_done(idx)) {
+                        continue;
+                    }
+                    auto local_i = i - (tx * tile_size - border);
+                    auto local_j = j - (ty * tile_size - border);
+                    auto p = tile_data(idx) + 4 * (local_j * tile_stride + local_i);
+                    sum.color_sum += color(p[0], p[1], p[2]);
+                    sum.weight_sum += p[3];
+                }
+            }
+            return sum.value();
+        }
+
+        // Hints the kernel that pixels in the given row of tiles won't be read again,
+        // so that converting a huge image keeps only a few rows of tiles resident at a time.
+        void release_tile_row(int ty) const {
+            const long page_size = sysconf(_SC_PAGESIZE);
+            auto begin = reinterpret_cast<uintptr_t>(tile_data(ty * tiles_x));
+            auto end = begin + tiles_x * tile_bytes;
+            begin &= ~static_cast<uintptr_t>(page_size - 1);
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+        }
+
+    public:
+        int width;
+        int height;
+        int tile_size;
+        int border;
+        int tiles_x;
+        int tiles_y;
+
+    private:
+        static constexpr const char *magic = "RTTILEFB";
+        static const uint32_t version = 2;
+        // Tile data is aligned so that the layout doesn't depend on the page size of the machine.
+        static const size_t data_alignment = 65536;
+
+        int fd = -1;
+        void *base = MAP_FAILED;
+        size_t file_size;
+        size_t data_offset;
+        size_t tile_bytes;
+        int tile_stride; // Pixels per row in a tile, including the border
+
+        void init_layout() {
+            tiles_x = (width + tile_size - 1) / tile_size;
+            tiles_y = (height + tile_size - 1) / tile_size;
+            auto flags_end = sizeof(tiled_framebuffer_header) + sizeof(uint32_t) * tile_count();
+            data_offset = (flags_end + data_alignment - 1) / data_alignment * data_alignment;
+            tile_stride = tile_size + 2 * border;
+            tile_bytes = sizeof(float) * 4 * tile_stride * tile_stride;
+            file_size = data_offset + tile_bytes * tile_count();
+        }
+
+        bool read_header(tiled_framebuffer_header &header) const {
+            return pread(fd, &header, sizeof(header), 0) == sizeof(header)
+                && memcmp(header.magic, magic, sizeof(header.magic)) == 0
+                && header.version == version
+                && header.tile_size > 0
+                && header.border <= header.tile_size;
+        }
+
+        void map(int prot) {
+            base = mmap(nullptr, file_size, prot, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED) {
+                fail("mmap");
+            }
+        }
+
+        uint32_t* tile_flags() const {
+            return reinterpret_cast<uint32_t*>(static_cast<char*>(base) + sizeof(tiled_framebuffer_header));
+        }
+
+        float* tile_data(int idx) const {
+            return reinterpret_cast<float*>(static_cast<char*>(base) + data_offset + tile_bytes * idx);
+        }
+
+        [[noreturn]] static void fail(const std::string &what) {
+            throw std::runtime_error(what + ": " + strerror(errno));
+        }
+};